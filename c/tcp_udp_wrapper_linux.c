@@ -7,6 +7,7 @@
 #include <sys/socket.h>
 #include <dirent.h>
 #include <ctype.h>
+#include <stdint.h>
 
 // TCP state values - equivalent to the Windows definitions
 #define TCP_STATE_CLOSED        1
@@ -22,6 +23,9 @@
 #define TCP_STATE_TIME_WAIT     11
 #define TCP_STATE_DELETE_TCB    12
 
+// Root of the proc filesystem, only ever pointed somewhere else by the tests
+static const char* proc_root = "/proc";
+
 // Structure to hold TCP connection information
 typedef struct {
     uint32_t state;        // TCP connection state
@@ -67,26 +71,27 @@ unsigned int hex_to_int(const char *hex) {
     return val;
 }
 
-// Helper function to find the PID owning a socket inode
+// Helper function to find the PID owning a socket inode. Stops at the first owner found, so a
+// socket shared by several processes resolves to whichever one readdir lists first
 int find_pid_of_inode(unsigned int inode) {
     DIR *dir;
     struct dirent *entry;
-    char path[256];
+    char path[1024];
     char link[256];
     int pid = -1;
     
     // Iterate through all processes
-    if ((dir = opendir("/proc")) != NULL) {
+    if ((dir = opendir(proc_root)) != NULL) {
         while ((entry = readdir(dir)) != NULL) {
             if (isdigit(entry->d_name[0])) {
-                snprintf(path, sizeof(path), "/proc/%s/fd", entry->d_name);
+                snprintf(path, sizeof(path), "%s/%s/fd", proc_root, entry->d_name);
                 DIR *fd_dir;
                 struct dirent *fd_entry;
                 
                 if ((fd_dir = opendir(path)) != NULL) {
                     while ((fd_entry = readdir(fd_dir)) != NULL) {
-                        snprintf(path, sizeof(path), "/proc/%s/fd/%s", 
-                                entry->d_name, fd_entry->d_name);
+                        snprintf(path, sizeof(path), "%s/%s/fd/%s", 
+                                proc_root, entry->d_name, fd_entry->d_name);
                         
                         ssize_t len = readlink(path, link, sizeof(link) - 1);
                         if (len != -1) {
@@ -113,10 +118,168 @@ int find_pid_of_inode(unsigned int inode) {
     return pid;
 }
 
+// Socket inode -> owning PID pair
+typedef struct {
+    uint32_t inode;
+    uint32_t pid;
+} SocketOwner;
+
+// Table of every socket owner on the system, sorted by inode then PID
+typedef struct {
+    uint32_t count;
+    uint32_t capacity;
+    SocketOwner* owners;
+} SocketOwners;
+
+static int socket_owners_push(SocketOwners* table, uint32_t inode, uint32_t pid) {
+    if (table->count == table->capacity) {
+        uint32_t capacity = table->capacity ? table->capacity * 2 : 256;
+        SocketOwner* owners = (SocketOwner*)realloc(table->owners, capacity * sizeof(SocketOwner));
+        if (!owners) return -1;
+        table->owners = owners;
+        table->capacity = capacity;
+    }
+    table->owners[table->count].inode = inode;
+    table->owners[table->count].pid = pid;
+    table->count++;
+    return 0;
+}
+
+static int socket_owner_cmp(const void* a, const void* b) {
+    const SocketOwner* x = (const SocketOwner*)a;
+    const SocketOwner* y = (const SocketOwner*)b;
+    if (x->inode != y->inode) return x->inode < y->inode ? -1 : 1;
+    if (x->pid != y->pid) return x->pid < y->pid ? -1 : 1;
+    return 0;
+}
+
+// Fills the table with a single walk over /proc/*/fd, instead of one walk per socket
+int collect_socket_owners_procfs(SocketOwners* table) {
+    DIR *dir;
+    struct dirent *entry;
+    char path[1024];
+    char link[256];
+
+    if ((dir = opendir(proc_root)) == NULL) return -1;
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (!isdigit(entry->d_name[0])) continue;
+
+        snprintf(path, sizeof(path), "%s/%s/fd", proc_root, entry->d_name);
+        DIR *fd_dir;
+        struct dirent *fd_entry;
+        uint32_t pid = (uint32_t)atoi(entry->d_name);
+
+        // Processes can exit mid-scan, a missing fd dir just means there is nothing to record
+        if ((fd_dir = opendir(path)) == NULL) continue;
+
+        while ((fd_entry = readdir(fd_dir)) != NULL) {
+            snprintf(path, sizeof(path), "%s/%s/fd/%s", proc_root, entry->d_name,
+                     fd_entry->d_name);
+
+            ssize_t len = readlink(path, link, sizeof(link) - 1);
+            if (len == -1) continue;
+            link[len] = '\0';
+
+            unsigned int fd_inode;
+            if (sscanf(link, "socket:[%u]", &fd_inode) == 1) {
+                if (socket_owners_push(table, fd_inode, pid) != 0) {
+                    closedir(fd_dir);
+                    closedir(dir);
+                    return -1;
+                }
+            }
+        }
+        closedir(fd_dir);
+    }
+    closedir(dir);
+    return 0;
+}
+
+// Builds the inode -> PID table sorted by inode, so every row can binary search it
+int collect_socket_owners(SocketOwners* table) {
+    table->count = 0;
+    table->capacity = 0;
+    table->owners = NULL;
+
+    int ret = collect_socket_owners_procfs(table);
+
+    if (ret == 0 && table->count > 1) {
+        qsort(table->owners, table->count, sizeof(SocketOwner), socket_owner_cmp);
+    }
+    return ret;
+}
+
+void free_socket_owners(SocketOwners* table) {
+    free(table->owners);
+    table->owners = NULL;
+    table->count = table->capacity = 0;
+}
+
+// Binary searches the table, a socket shared by several processes resolves to the lowest PID
+int find_socket_owner(const SocketOwners* table, unsigned int inode) {
+    uint32_t lo = 0, hi = table->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (table->owners[mid].inode < inode) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < table->count && table->owners[lo].inode == inode) return (int)table->owners[lo].pid;
+    return -1;
+}
+
+// Resolves an inode through the table, or through a full /proc walk if the table failed to build
+static int resolve_socket_pid(const SocketOwners* table, int have_table, unsigned int inode) {
+    return have_table ? find_socket_owner(table, inode) : find_pid_of_inode(inode);
+}
+
+// Maps the kernel's TCP_* states from include/net/tcp_states.h to the Windows MIB values
+uint32_t map_linux_tcp_state(unsigned int state) {
+    switch (state) {
+        case 1:  return TCP_STATE_ESTAB;      // TCP_ESTABLISHED
+        case 2:  return TCP_STATE_SYN_SENT;   // TCP_SYN_SENT
+        case 3:  return TCP_STATE_SYN_RCVD;   // TCP_SYN_RECV
+        case 4:  return TCP_STATE_FIN_WAIT1;  // TCP_FIN_WAIT1
+        case 5:  return TCP_STATE_FIN_WAIT2;  // TCP_FIN_WAIT2
+        case 6:  return TCP_STATE_TIME_WAIT;  // TCP_TIME_WAIT
+        case 7:  return TCP_STATE_CLOSED;     // TCP_CLOSE
+        case 8:  return TCP_STATE_CLOSE_WAIT; // TCP_CLOSE_WAIT
+        case 9:  return TCP_STATE_LAST_ACK;   // TCP_LAST_ACK
+        case 10: return TCP_STATE_LISTEN;     // TCP_LISTEN
+        case 11: return TCP_STATE_CLOSING;    // TCP_CLOSING
+        case 12: return TCP_STATE_SYN_RCVD;   // TCP_NEW_SYN_RECV
+        default: return 0;
+    }
+}
+
+// Parses one row of /proc/net/tcp or /proc/net/udp, both share the same column layout.
+// Returns -1 for rows that don't have every column up to the inode
+int parse_proc_net_line(const char* line, uint32_t* local_addr, uint32_t* local_port,
+                        uint32_t* remote_addr, uint32_t* remote_port, uint32_t* state,
+                        uint32_t* inode) {
+    unsigned int la, lp, ra, rp, st, ino;
+
+    // sl: local rem st tx_queue:rx_queue tr:tm->when retrnsmt uid timeout inode
+    if (sscanf(line, "%*d: %x:%x %x:%x %x %*x:%*x %*x:%*x %*x %*u %*d %u",
+               &la, &lp, &ra, &rp, &st, &ino) != 6) {
+        return -1;
+    }
+    if (lp > 0xFFFF || rp > 0xFFFF) return -1;
+
+    *local_addr = ntohl(la);
+    *local_port = lp;
+    *remote_addr = ntohl(ra);
+    *remote_port = rp;
+    *state = st;
+    *inode = ino;
+    return 0;
+}
+
 // Function to get TCP connection info
 TcpConnections* get_tcp_connections() {
     FILE *fp;
     char line[512];
+    char path[1024];
     uint32_t result_count = 0;
     TcpConnections* result = (TcpConnections*)malloc(sizeof(TcpConnections));
     
@@ -125,7 +288,8 @@ TcpConnections* get_tcp_connections() {
     result->count = 0;
     result->connections = NULL;
     
-    if ((fp = fopen("/proc/net/tcp", "r")) == NULL) {
+    snprintf(path, sizeof(path), "%s/net/tcp", proc_root);
+    if ((fp = fopen(path, "r")) == NULL) {
         free(result);
         return NULL;
     }
@@ -146,31 +310,35 @@ TcpConnections* get_tcp_connections() {
         return NULL;
     }
     
+    SocketOwners owners;
+    int have_owners = collect_socket_owners(&owners) == 0;
+
     // Second pass: parse lines
     rewind(fp);
     fgets(line, sizeof(line), fp);
     
     uint32_t idx = 0;
     while (fgets(line, sizeof(line), fp) != NULL && idx < result_count) {
-        unsigned int local_addr, local_port;
-        unsigned int remote_addr, remote_port;
-        unsigned int state, inode;
+        uint32_t local_addr, local_port;
+        uint32_t remote_addr, remote_port;
+        uint32_t state, inode;
         
-        sscanf(line, "%*d: %x:%x %x:%x %x %*x:%*x %*x:%*x %*x %*d %*d %u",
-               &local_addr, &local_port,
-               &remote_addr, &remote_port,
-               &state, &inode);
+        if (parse_proc_net_line(line, &local_addr, &local_port, &remote_addr, &remote_port,
+                                &state, &inode) != 0) {
+            continue;
+        }
         
-        result->connections[idx].state = state + 1; // +1 to match Windows values
-        result->connections[idx].local_addr = ntohl(local_addr);
+        result->connections[idx].state = map_linux_tcp_state(state);
+        result->connections[idx].local_addr = local_addr;
         result->connections[idx].local_port = local_port;
-        result->connections[idx].remote_addr = ntohl(remote_addr);
+        result->connections[idx].remote_addr = remote_addr;
         result->connections[idx].remote_port = remote_port;
-        result->connections[idx].pid = find_pid_of_inode(inode);
+        result->connections[idx].pid = resolve_socket_pid(&owners, have_owners, inode);
         
         idx++;
     }
     
+    free_socket_owners(&owners);
     fclose(fp);
     result->count = idx;
     return result;
@@ -188,6 +356,7 @@ void free_tcp_connections(TcpConnections* connections) {
 UdpEndpoints* get_udp_endpoints() {
     FILE *fp;
     char line[512];
+    char path[1024];
     uint32_t result_count = 0;
     UdpEndpoints* result = (UdpEndpoints*)malloc(sizeof(UdpEndpoints));
     
@@ -196,7 +365,8 @@ UdpEndpoints* get_udp_endpoints() {
     result->count = 0;
     result->endpoints = NULL;
     
-    if ((fp = fopen("/proc/net/udp", "r")) == NULL) {
+    snprintf(path, sizeof(path), "%s/net/udp", proc_root);
+    if ((fp = fopen(path, "r")) == NULL) {
         free(result);
         return NULL;
     }
@@ -217,30 +387,35 @@ UdpEndpoints* get_udp_endpoints() {
         return NULL;
     }
     
+    SocketOwners owners;
+    int have_owners = collect_socket_owners(&owners) == 0;
+
     // Second pass: parse lines
     rewind(fp);
     fgets(line, sizeof(line), fp);
     
     uint32_t idx = 0;
     while (fgets(line, sizeof(line), fp) != NULL && idx < result_count) {
-        unsigned int local_addr, local_port;
-        unsigned int remote_addr, remote_port;
-        unsigned int inode;
+        uint32_t local_addr, local_port;
+        uint32_t remote_addr, remote_port;
+        uint32_t state, inode;
         
-        sscanf(line, "%*d: %x:%x %x:%x %*x %*x:%*x %*x:%*x %*x %*d %*d %u",
-               &local_addr, &local_port,
-               &remote_addr, &remote_port,
-               &inode);
+        // UDP has no real state machine, connect()ed sockets show up with a remote address
+        if (parse_proc_net_line(line, &local_addr, &local_port, &remote_addr, &remote_port,
+                                &state, &inode) != 0) {
+            continue;
+        }
         
-        result->endpoints[idx].local_addr = ntohl(local_addr);
+        result->endpoints[idx].local_addr = local_addr;
         result->endpoints[idx].local_port = local_port;
-        result->endpoints[idx].remote_addr = ntohl(remote_addr);
+        result->endpoints[idx].remote_addr = remote_addr;
         result->endpoints[idx].remote_port = remote_port;
-        result->endpoints[idx].pid = find_pid_of_inode(inode);
+        result->endpoints[idx].pid = resolve_socket_pid(&owners, have_owners, inode);
         
         idx++;
     }
     
+    free_socket_owners(&owners);
     fclose(fp);
     result->count = idx;
     return result;
@@ -300,25 +475,36 @@ void print_tcp_connections(TcpConnections* connections) {
     }
 }
 
+// Helper function to describe a UDP endpoint, UDP sockets never listen so this only tells
+// connected sockets apart from unconnected ones
+const char* get_udp_state_string(const UdpEndpointInfo* endpoint) {
+    if (endpoint->remote_addr == 0 && endpoint->remote_port == 0) return "UNCONN";
+    return "CONNECTED";
+}
+
 // Helper function to print UDP endpoint info
 void print_udp_endpoints(UdpEndpoints* endpoints) {
     if (!endpoints) return;
     
     printf("Total UDP endpoints: %u\n", endpoints->count);
-    printf("----------------------------------------------\n");
-    printf("  Local Address:Port      State       PID\n");
-    printf("----------------------------------------------\n");
+    printf("------------------------------------------------------\n");
+    printf("  Local Address:Port    Remote Address:Port    State    PID\n");
+    printf("------------------------------------------------------\n");
     
     for (uint32_t i = 0; i < endpoints->count; i++) {
-        struct in_addr local_addr;
-        char local_ip[INET_ADDRSTRLEN];
+        struct in_addr local_addr, remote_addr;
+        char local_ip[INET_ADDRSTRLEN], remote_ip[INET_ADDRSTRLEN];
         
         local_addr.s_addr = htonl(endpoints->endpoints[i].local_addr);
+        remote_addr.s_addr = htonl(endpoints->endpoints[i].remote_addr);
+        
         inet_ntop(AF_INET, &local_addr, local_ip, sizeof(local_ip));
+        inet_ntop(AF_INET, &remote_addr, remote_ip, sizeof(remote_ip));
         
-        printf("%15s:%-5d    LISTENING   %5d\n",
-            local_ip, 
-            endpoints->endpoints[i].local_port,
+        printf("%15s:%-5d %15s:%-5d %12s %5d\n",
+            local_ip, endpoints->endpoints[i].local_port,
+            remote_ip, endpoints->endpoints[i].remote_port,
+            get_udp_state_string(&endpoints->endpoints[i]),
             endpoints->endpoints[i].pid);
     }
 }
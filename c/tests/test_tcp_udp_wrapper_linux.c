@@ -0,0 +1,282 @@
+// Tests for c/tcp_udp_wrapper_linux.c, run against the fixed /proc tree in c/tests/fixtures.
+// The wrapper is included directly so its syscalls and allocations can be counted, which is
+// what the perf assertions below are built on.
+//
+// build: gcc -O2 -Wall -Wextra c/tests/test_tcp_udp_wrapper_linux.c -o bin/test_c
+// run:   ./bin/test_c [fixture root, default c/tests/fixtures/proc]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <stdint.h>
+
+// Counters for everything the collection layer does per snapshot
+typedef struct {
+    uint32_t readlinks;
+    uint32_t opendirs;
+    uint32_t fopens;
+    uint32_t allocs;   // New blocks, from malloc or realloc(NULL, ...)
+    uint32_t reallocs; // Every realloc call, growth included
+    uint32_t frees;
+} Counters;
+
+static Counters counters;
+
+static ssize_t counted_readlink(const char* path, char* buf, size_t size) {
+    counters.readlinks++;
+    return readlink(path, buf, size);
+}
+
+static DIR* counted_opendir(const char* path) {
+    counters.opendirs++;
+    return opendir(path);
+}
+
+static FILE* counted_fopen(const char* path, const char* mode) {
+    counters.fopens++;
+    return fopen(path, mode);
+}
+
+static void* counted_malloc(size_t size) {
+    counters.allocs++;
+    return malloc(size);
+}
+
+static void* counted_realloc(void* ptr, size_t size) {
+    counters.reallocs++;
+    if (!ptr) counters.allocs++;
+    return realloc(ptr, size);
+}
+
+static void counted_free(void* ptr) {
+    if (ptr) counters.frees++;
+    free(ptr);
+}
+
+#define readlink(path, buf, size) counted_readlink(path, buf, size)
+#define opendir(path) counted_opendir(path)
+#define fopen(path, mode) counted_fopen(path, mode)
+#define malloc(size) counted_malloc(size)
+#define realloc(ptr, size) counted_realloc(ptr, size)
+#define free(ptr) counted_free(ptr)
+
+#include "../tcp_udp_wrapper_linux.c"
+
+#undef readlink
+#undef opendir
+#undef fopen
+#undef malloc
+#undef realloc
+#undef free
+
+// Limits for one snapshot of the fixture tree (3 processes, 13 fd dir entries including . and ..).
+// Every fd may be read at most once per snapshot no matter how many sockets are being resolved
+#define FIXTURE_FD_ENTRIES 13
+#define FIXTURE_PROCESSES 3
+#define MAX_READLINKS_PER_SNAPSHOT FIXTURE_FD_ENTRIES
+#define MAX_OPENDIRS_PER_SNAPSHOT (FIXTURE_PROCESSES + 1)
+#define MAX_FOPENS_PER_SNAPSHOT 1
+#define MAX_ALLOCS_PER_SNAPSHOT 3 // result, rows, socket owner table
+// The owner table starts with room for 256 sockets, the fixture never needs it to grow
+#define MAX_REALLOCS_PER_SNAPSHOT 1
+
+static int failures = 0;
+
+#define CHECK(cond)                                                                                \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);              \
+            failures++;                                                                            \
+        }                                                                                          \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                 \
+    do {                                                                                           \
+        long long a_ = (long long)(actual), e_ = (long long)(expected);                            \
+        if (a_ != e_) {                                                                            \
+            fprintf(stderr, "%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual,     \
+                    a_, e_);                                                                       \
+            failures++;                                                                            \
+        }                                                                                          \
+    } while (0)
+
+static void test_parse_proc_net_line(void) {
+    uint32_t la, lp, ra, rp, st, ino;
+
+    CHECK_EQ(parse_proc_net_line("   1: 0100007F:1F90 0100007F:C350 01 00000000:00000000 "
+                                 "00:00000000 00000000  1000        0 1002 1 0000000000000000",
+                                 &la, &lp, &ra, &rp, &st, &ino),
+             0);
+    CHECK_EQ(la, 0x7F000001);
+    CHECK_EQ(lp, 8080);
+    CHECK_EQ(ra, 0x7F000001);
+    CHECK_EQ(rp, 50000);
+    CHECK_EQ(st, 1);
+    CHECK_EQ(ino, 1002);
+
+    // header, truncated and garbage rows must be rejected instead of half parsed
+    CHECK_EQ(parse_proc_net_line("  sl  local_address rem_address   st tx_queue rx_queue", &la,
+                                 &lp, &ra, &rp, &st, &ino),
+             -1);
+    CHECK_EQ(parse_proc_net_line("   4: truncated row", &la, &lp, &ra, &rp, &st, &ino), -1);
+    CHECK_EQ(parse_proc_net_line("   0: 0100007F:1F90 00000000:0000 0A 00000000:00000000",
+                                 &la, &lp, &ra, &rp, &st, &ino),
+             -1);
+    CHECK_EQ(parse_proc_net_line("", &la, &lp, &ra, &rp, &st, &ino), -1);
+}
+
+static void test_tcp_state_mapping(void) {
+    CHECK_EQ(map_linux_tcp_state(1), TCP_STATE_ESTAB);
+    CHECK_EQ(map_linux_tcp_state(2), TCP_STATE_SYN_SENT);
+    CHECK_EQ(map_linux_tcp_state(3), TCP_STATE_SYN_RCVD);
+    CHECK_EQ(map_linux_tcp_state(4), TCP_STATE_FIN_WAIT1);
+    CHECK_EQ(map_linux_tcp_state(5), TCP_STATE_FIN_WAIT2);
+    CHECK_EQ(map_linux_tcp_state(6), TCP_STATE_TIME_WAIT);
+    CHECK_EQ(map_linux_tcp_state(7), TCP_STATE_CLOSED);
+    CHECK_EQ(map_linux_tcp_state(8), TCP_STATE_CLOSE_WAIT);
+    CHECK_EQ(map_linux_tcp_state(9), TCP_STATE_LAST_ACK);
+    CHECK_EQ(map_linux_tcp_state(10), TCP_STATE_LISTEN);
+    CHECK_EQ(map_linux_tcp_state(11), TCP_STATE_CLOSING);
+    CHECK_EQ(map_linux_tcp_state(12), TCP_STATE_SYN_RCVD);
+    CHECK_EQ(map_linux_tcp_state(0), 0);
+    CHECK_EQ(map_linux_tcp_state(42), 0);
+
+    CHECK(strcmp(get_tcp_state_string(map_linux_tcp_state(10)), "LISTEN") == 0);
+    CHECK(strcmp(get_tcp_state_string(map_linux_tcp_state(1)), "ESTABLISHED") == 0);
+    CHECK(strcmp(get_tcp_state_string(0), "UNKNOWN") == 0);
+}
+
+static void test_socket_owners(void) {
+    SocketOwners owners;
+
+    memset(&counters, 0, sizeof(counters));
+    CHECK_EQ(collect_socket_owners(&owners), 0);
+    CHECK_EQ(owners.count, 5);
+
+    CHECK_EQ(find_socket_owner(&owners, 1001), 100);
+    CHECK_EQ(find_socket_owner(&owners, 1002), 100); // shared with 200, lowest pid wins
+    CHECK_EQ(find_socket_owner(&owners, 1003), 300);
+    CHECK_EQ(find_socket_owner(&owners, 2001), 300);
+    CHECK_EQ(find_socket_owner(&owners, 999), -1); // pipe, not a socket
+    CHECK_EQ(find_socket_owner(&owners, 0), -1);
+    CHECK_EQ(find_socket_owner(&owners, 4242), -1);
+
+    // the per inode walk stops at the first owner, which one that is for a shared socket depends
+    // on the readdir order the checkout's filesystem gives the fixture directories
+    CHECK_EQ(find_pid_of_inode(1001), 100);
+    int shared = find_pid_of_inode(1002);
+    CHECK(shared == 100 || shared == 200);
+    CHECK_EQ(find_pid_of_inode(2001), 300);
+    CHECK_EQ(find_pid_of_inode(4242), -1);
+
+    free_socket_owners(&owners);
+}
+
+static void test_tcp_snapshot(void) {
+    memset(&counters, 0, sizeof(counters));
+    TcpConnections* tcp = get_tcp_connections();
+    Counters snapshot = counters;
+
+    CHECK(tcp != NULL);
+    if (!tcp) return;
+
+    CHECK_EQ(tcp->count, 4); // the truncated row is skipped
+
+    TcpConnectionInfo* c = tcp->connections;
+    CHECK_EQ(c[0].state, TCP_STATE_LISTEN);
+    CHECK_EQ(c[0].local_addr, 0x7F000001);
+    CHECK_EQ(c[0].local_port, 8080);
+    CHECK_EQ(c[0].remote_addr, 0);
+    CHECK_EQ(c[0].remote_port, 0);
+    CHECK_EQ(c[0].pid, 100);
+
+    CHECK_EQ(c[1].state, TCP_STATE_ESTAB);
+    CHECK_EQ(c[1].remote_port, 50000);
+    CHECK_EQ(c[1].pid, 100);
+
+    CHECK_EQ(c[2].state, TCP_STATE_ESTAB);
+    CHECK_EQ(c[2].local_addr, 0x0A00000A);
+    CHECK_EQ(c[2].local_port, 22);
+    CHECK_EQ(c[2].remote_addr, 0x0A000005);
+    CHECK_EQ(c[2].remote_port, 54321);
+    CHECK_EQ(c[2].pid, 300);
+
+    CHECK_EQ(c[3].state, TCP_STATE_TIME_WAIT);
+    CHECK_EQ(c[3].pid, (uint32_t)-1); // time wait sockets have no owner
+
+    CHECK(snapshot.readlinks <= MAX_READLINKS_PER_SNAPSHOT);
+    CHECK(snapshot.opendirs <= MAX_OPENDIRS_PER_SNAPSHOT);
+    CHECK(snapshot.fopens <= MAX_FOPENS_PER_SNAPSHOT);
+    CHECK(snapshot.allocs <= MAX_ALLOCS_PER_SNAPSHOT);
+    CHECK(snapshot.reallocs <= MAX_REALLOCS_PER_SNAPSHOT);
+
+    free_tcp_connections(tcp);
+    CHECK_EQ(counters.frees, counters.allocs);
+}
+
+static void test_udp_snapshot(void) {
+    memset(&counters, 0, sizeof(counters));
+    UdpEndpoints* udp = get_udp_endpoints();
+    Counters snapshot = counters;
+
+    CHECK(udp != NULL);
+    if (!udp) return;
+
+    CHECK_EQ(udp->count, 2);
+
+    UdpEndpointInfo* e = udp->endpoints;
+    CHECK_EQ(e[0].local_addr, 0);
+    CHECK_EQ(e[0].local_port, 53);
+    CHECK_EQ(e[0].pid, 300);
+    CHECK(strcmp(get_udp_state_string(&e[0]), "UNCONN") == 0);
+
+    CHECK_EQ(e[1].local_addr, 0x7F000001);
+    CHECK_EQ(e[1].local_port, 8081);
+    CHECK_EQ(e[1].remote_port, 53);
+    CHECK_EQ(e[1].pid, (uint32_t)-1);
+    CHECK(strcmp(get_udp_state_string(&e[1]), "CONNECTED") == 0);
+
+    CHECK(snapshot.readlinks <= MAX_READLINKS_PER_SNAPSHOT);
+    CHECK(snapshot.opendirs <= MAX_OPENDIRS_PER_SNAPSHOT);
+    CHECK(snapshot.fopens <= MAX_FOPENS_PER_SNAPSHOT);
+    CHECK(snapshot.allocs <= MAX_ALLOCS_PER_SNAPSHOT);
+    CHECK(snapshot.reallocs <= MAX_REALLOCS_PER_SNAPSHOT);
+
+    free_udp_endpoints(udp);
+    CHECK_EQ(counters.frees, counters.allocs);
+}
+
+static void test_missing_proc_root(void) {
+    const char* saved = proc_root;
+    proc_root = "c/tests/fixtures/does-not-exist";
+
+    CHECK(get_tcp_connections() == NULL);
+    CHECK(get_udp_endpoints() == NULL);
+    CHECK_EQ(find_pid_of_inode(1001), -1);
+
+    proc_root = saved;
+}
+
+int main(int argc, char** argv) {
+    proc_root = argc > 1 ? argv[1] : "c/tests/fixtures/proc";
+
+    test_parse_proc_net_line();
+    test_tcp_state_mapping();
+    test_socket_owners();
+    test_tcp_snapshot();
+    test_udp_snapshot();
+    test_missing_proc_root();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all c tests passed\n");
+    return 0;
+}
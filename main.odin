@@ -8,80 +8,15 @@ import "core:fmt"
 import "core:log"
 import "core:os"
 import "core:path/filepath"
-import "core:slice"
 import "core:strings"
+import "core:sync"
 import "core:testing"
 import "core:text/regex"
+import "core:thread"
 import "core:time"
 import "tcp"
-import "udp"
 import "utils"
 
-// Common interface for both TCP and UDP connection types
-Connection_Info :: struct {
-	local_addr:  u32,
-	local_port:  u32,
-	remote_addr: u32,
-	remote_port: u32,
-	pid:         u32,
-	state:       u32, // Optional for UDP (always 0)
-}
-
-Connections :: struct {
-	count:       u32,
-	connections: []Connection_Info,
-}
-
-get_connections :: proc(use_udp: bool) -> (result: Connections) {
-	if use_udp {
-		udp_endpoints := udp.get_udp_endpoints()
-		if udp_endpoints == nil {
-			return {}
-		}
-		defer udp.free_udp_endpoints(udp_endpoints)
-
-		// Convert UDP endpoints to our common format
-		result.count = udp_endpoints.count
-		result.connections = make([]Connection_Info, int(udp_endpoints.count))
-
-		udp_slice := slice.from_ptr(udp_endpoints.endpoints, int(udp_endpoints.count))
-		for i := 0; i < int(udp_endpoints.count); i += 1 {
-			result.connections[i] = {
-				local_addr  = udp_slice[i].local_addr,
-				local_port  = u32(udp_slice[i].local_port),
-				remote_addr = udp_slice[i].remote_addr,
-				remote_port = u32(udp_slice[i].remote_port),
-				pid         = udp_slice[i].pid,
-				state       = 0, // UDP doesn't have states
-			}
-		}
-	} else {
-		tcp_connections := tcp.get_tcp_connections()
-		if tcp_connections == nil {
-			return {}
-		}
-		defer tcp.free_tcp_connections(tcp_connections)
-
-		// Convert TCP connections to our common format
-		result.count = tcp_connections.count
-		result.connections = make([]Connection_Info, int(tcp_connections.count))
-
-		tcp_slice := slice.from_ptr(tcp_connections.connections, int(tcp_connections.count))
-		for i := 0; i < int(tcp_connections.count); i += 1 {
-			result.connections[i] = {
-				local_addr  = tcp_slice[i].local_addr,
-				local_port  = u32(tcp_slice[i].local_port),
-				remote_addr = tcp_slice[i].remote_addr,
-				remote_port = u32(tcp_slice[i].remote_port),
-				pid         = tcp_slice[i].pid,
-				state       = tcp_slice[i].state,
-			}
-		}
-	}
-
-	return result
-}
-
 // options paresed from cli args
 Options :: struct {
 	use_udp:  bool `args:"name=udp" usage:"if true, searches udp connections instead of tcp"`,
@@ -90,6 +25,11 @@ Options :: struct {
 	watch:    string `args:"name=watch" usage:"if set krobe will collect data on this set interval, the value is a string representing a duration, for example 20s"`,
 	search:   string `args:"name=search" usage:"provide a regex that should be used to filter output results, if your regex requires spaces wrap it in 'quotes'"`,
 	use_ci:   bool `args:"name=ci" usage:"if set the -search regex matching will be case insensitive"`,
+	sort:     string `args:"name=sort" usage:"sorts the output by one of: port, pid, remote"`,
+	group:    bool `args:"name=group" usage:"if true, groups the output by the -sort key (port if -sort is not set), remotes are grouped by /24"`,
+	port:     int `args:"name=port" usage:"if set, only shows connections on this local port"`,
+	pid:      int `args:"name=pid" usage:"if set, only shows connections owned by this pid"`,
+	remote:   string `args:"name=remote" usage:"if set, only shows connections to this remote address, a /N suffix matches a whole network, for example 10.0.0.0/24"`,
 }
 
 opts: Options
@@ -140,6 +80,56 @@ validate_search_regex :: proc(
 	return
 }
 
+parse_sort_key :: proc(s: string) -> Maybe(Sort_Key) {
+	switch strings.to_lower(strings.trim_space(s), context.temp_allocator) {
+	case "":
+		return .None
+	case "port":
+		return .Port
+	case "pid":
+		return .Pid
+	case "remote":
+		return .Remote
+	}
+	return nil
+}
+
+validate_sort_key :: proc(
+	model: rawptr,
+	name: string,
+	value: any,
+	args_tag: string,
+) -> (
+	error: string,
+) {
+	if name == "sort" {
+		v := value.(string)
+		if parse_sort_key(v) == nil {
+			error = fmt.aprintf("incorrect -sort key got: %s, valid keys: port, pid, remote", v)
+		}
+	}
+
+	return
+}
+
+validate_remote :: proc(
+	model: rawptr,
+	name: string,
+	value: any,
+	args_tag: string,
+) -> (
+	error: string,
+) {
+	if name == "remote" {
+		v := value.(string)
+		if _, _, ok := utils.parse_ipv4_range(v); !ok {
+			error = fmt.aprintf("incorrect -remote address got: %s, valid example: 10.0.0.5, 10.0.0.0/24", v)
+		}
+	}
+
+	return
+}
+
 @(test)
 main_test :: proc(t: ^testing.T) {
 	defer free_all(context.allocator)
@@ -159,6 +149,12 @@ json_out :: struct {
 	path:  string,
 }
 
+// the struct outputed in an array when -json and -group are set
+json_group :: struct {
+	group:       string,
+	connections: []json_out,
+}
+
 RELEASE :: #config(RELEASE, false)
 
 main :: proc() {
@@ -167,6 +163,8 @@ main :: proc() {
 	style: flags.Parsing_Style = .Odin
 	flags.register_flag_checker(validate_watch_duration)
 	flags.register_flag_checker(validate_search_regex)
+	flags.register_flag_checker(validate_sort_key)
+	flags.register_flag_checker(validate_remote)
 	flags.parse_or_exit(&opts, os.args, style)
 
 	log_opts: bit_set[runtime.Logger_Option]
@@ -191,10 +189,19 @@ main :: proc() {
 		}
 	}
 
+	// the calling thread is the extra worker, threads are only spawned once a snapshot needs them
+	rp := Resolve_Pool {
+		threads = max(os.processor_core_count() - 1, 1),
+	}
+	defer resolve_pool_destroy(&rp)
+
 	if opts.watch != "" {
 		for {
 			start := time.now()
-			work()
+			work(&rp)
+			// labels, the sort key and index scratch all live on the temp allocator,
+			// without this every tick would keep its share of it forever
+			free_all(context.temp_allocator)
 			end := time.now()
 			diff := time.diff(start, end)
 			sleep := duration - diff
@@ -203,11 +210,189 @@ main :: proc() {
 			}
 		}
 	} else {
-		work()
+		work(&rp)
 	}
 }
 
-work :: proc() {
+// a connection that passed the state filter, together with the data the workers resolved for it
+Row :: struct {
+	conn:  Connection_Info,
+	path:  Maybe(string),
+	title: Maybe(string),
+	keep:  bool, // false when the exe path could not be read or did not match -search
+}
+
+// what every worker needs to resolve and filter its rows, shared read only between workers
+Resolve_Options :: struct {
+	pattern:   string,
+	reg_flags: regex.Flags,
+	full:      bool,
+}
+
+// contiguous range of rows handed to a single worker
+Resolve_Chunk :: struct {
+	rows:     []Row,
+	options:  Resolve_Options,
+	logger:   log.Logger,
+	finished: ^sync.Wait_Group, // nil when the chunk runs on the calling thread only
+}
+
+// worker pool for resolve_rows, only started by the first snapshot large enough to be split
+// and then reused by every later -watch tick
+Resolve_Pool :: struct {
+	threads: int, // worker threads besides the calling one
+	pool:    thread.Pool,
+	started: bool,
+}
+
+resolve_pool_destroy :: proc(rp: ^Resolve_Pool) {
+	if rp.started {
+		thread.pool_finish(&rp.pool)
+		thread.pool_destroy(&rp.pool)
+		rp.started = false
+	}
+}
+
+// below this many rows per worker handing them to the pool costs more than the readlinks it saves
+ROWS_PER_WORKER_MIN :: 256
+
+// resolves exe paths (and window titles on windows) and applies -search to every row in the chunk
+resolve_chunk :: proc(chunk: ^Resolve_Chunk) {
+	// every worker compiles its own copy of the regex so no match state is shared between threads
+	reg: regex.Regular_Expression
+	defer regex.destroy(reg)
+	if chunk.options.pattern != "" {
+		err: regex.Error
+		reg, err = regex.create(chunk.options.pattern, chunk.options.reg_flags)
+		if err != nil {
+			return
+		}
+	}
+
+	for &row in chunk.rows {
+		r := utils.get_proc_info(row.conn.pid)
+		if r == nil {
+			continue
+		}
+		if !chunk.options.full {
+			r = filepath.base(r.?)
+		}
+		if chunk.options.pattern != "" {
+			if _, ok := regex.match(reg, r.?); !ok {
+				continue
+			}
+		}
+		when ODIN_OS == .Windows {
+			row.title = utils.get_window_title(tcp.get_hwnd(row.conn.pid))
+		}
+		row.path = r
+		row.keep = true
+	}
+}
+
+resolve_task :: proc(task: thread.Task) {
+	chunk := cast(^Resolve_Chunk)task.data
+	context.allocator = task.allocator
+	context.logger = chunk.logger
+	resolve_chunk(chunk)
+	sync.wait_group_done(chunk.finished)
+}
+
+// splits the rows into one contiguous chunk per worker, every worker only writes to its own rows
+// so the output keeps the input order no matter which worker finishes first.
+// without a pool everything runs on the calling thread.
+// returns how many workers (including the calling thread) took part
+resolve_rows :: proc(rp: ^Resolve_Pool, rows: []Row, options: Resolve_Options) -> (workers: int) {
+	workers = 1
+	if rp != nil {
+		workers = min(rp.threads + 1, len(rows) / ROWS_PER_WORKER_MIN)
+	}
+	if workers <= 1 {
+		chunk := Resolve_Chunk{rows, options, context.logger, nil}
+		resolve_chunk(&chunk)
+		return 1
+	}
+
+	if !rp.started {
+		thread.pool_init(&rp.pool, context.allocator, rp.threads)
+		thread.pool_start(&rp.pool)
+		rp.started = true
+	}
+
+	finished: sync.Wait_Group
+	sync.wait_group_add(&finished, workers)
+
+	chunks := make([]Resolve_Chunk, workers)
+	defer delete(chunks)
+
+	size := (len(rows) + workers - 1) / workers
+	for i in 0 ..< workers {
+		lo := min(i * size, len(rows))
+		hi := min(lo + size, len(rows))
+		chunks[i] = {rows[lo:hi], options, context.logger, &finished}
+		thread.pool_add_task(&rp.pool, context.allocator, resolve_task, &chunks[i], i)
+	}
+
+	// the calling thread helps drain the queue, then blocks until the chunks still running on
+	// workers are done
+	for task in thread.pool_pop_waiting(&rp.pool) {
+		thread.pool_do_work(&rp.pool, task)
+	}
+	sync.wait_group_wait(&finished)
+
+	// finished tasks pile up in the pool until popped, drop them so the pool doesn't grow per tick
+	for _ in thread.pool_pop_done(&rp.pool) {}
+
+	return
+}
+
+@(test)
+resolve_rows_test :: proc(t: ^testing.T) {
+	defer free_all(context.allocator)
+
+	// rows owned by this process resolve, rows with a pid that can't exist never do
+	self := utils.current_pid()
+	make_rows :: proc(self: u32) -> []Row {
+		rows := make([]Row, 4 * ROWS_PER_WORKER_MIN + 7)
+		for &row, i in rows {
+			row.conn.local_port = u32(i)
+			row.conn.pid = self if i % 3 != 0 else max(u32)
+		}
+		return rows
+	}
+	options := Resolve_Options {
+		pattern   = ".",
+		reg_flags = {.Global},
+	}
+
+	serial := make_rows(self)
+	defer delete(serial)
+	testing.expect_value(t, resolve_rows(nil, serial, options), 1)
+
+	rp := Resolve_Pool {
+		threads = 3,
+	}
+	defer resolve_pool_destroy(&rp)
+
+	testing.expect_value(t, resolve_rows(&rp, serial[:ROWS_PER_WORKER_MIN], options), 1)
+	testing.expect(t, !rp.started) // too small to be split, the pool is never started
+
+	// run twice on the same pool, the second batch must not see tasks left over from the first
+	for _ in 0 ..< 2 {
+		threaded := make_rows(self)
+		defer delete(threaded)
+		testing.expect_value(t, resolve_rows(&rp, threaded, options), 4)
+
+		for row, i in threaded {
+			testing.expect_value(t, row.conn.local_port, u32(i))
+			testing.expect_value(t, row.keep, serial[i].keep)
+			testing.expect_value(t, row.path.? or_else "", serial[i].path.? or_else "")
+			testing.expect_value(t, row.keep, i % 3 != 0)
+		}
+	}
+}
+
+work :: proc(rp: ^Resolve_Pool = nil) {
 	connections := get_connections(opts.use_udp)
 
 	if len(connections.connections) == 0 {
@@ -216,28 +401,56 @@ work :: proc() {
 		os.exit(69)
 	}
 
-	reg: regex.Regular_Expression
-    reg_flags: regex.Flags
-	err: regex.Error
-	defer regex.destroy(reg)
+	pattern: string
+	reg_flags: regex.Flags
 	if opts.search != "" {
-        if opts.use_ci {
-            reg_flags = {.Case_Insensitive, .Global}
-        } else {
-            reg_flags = {.Global}
-        }
-		pattern := utils.trim_both_sides(opts.search, "\"")
+		if opts.use_ci {
+			reg_flags = {.Case_Insensitive, .Global}
+		} else {
+			reg_flags = {.Global}
+		}
+		pattern = utils.trim_both_sides(opts.search, "\"")
 		pattern = utils.trim_both_sides(pattern, "\'")
-		reg, err = regex.create(pattern, reg_flags)
+		reg, err := regex.create(pattern, reg_flags)
 		if err != nil {
 			log.fatalf("failed to compile the provided regex pattern, pattern: %s", pattern)
 		}
+		regex.destroy(reg)
 	}
 
-	json_struct := make([dynamic]json_out)
-	defer delete(json_struct)
+	sort_key := parse_sort_key(opts.sort).? or_else .None
+	if opts.group && sort_key == .None {
+		sort_key = .Port
+	}
+
+	filter: Connection_Filter
+	if opts.port != 0 {
+		filter.port = u32(opts.port)
+	}
+	if opts.pid != 0 {
+		filter.pid = u32(opts.pid)
+	}
+	if opts.remote != "" {
+		if lo, hi, ok := utils.parse_ipv4_range(opts.remote); ok {
+			filter.remote = [2]u32{lo, hi}
+		}
+	}
+
+	// only -sort builds an index, a filter on the same key binary searches it and the others
+	// are checked while walking the sorted order
+	index := Connection_Index {
+		connections = connections.connections,
+	}
+	defer index_destroy(&index)
+	selected := index_query(&index, filter, sort_key)
+	defer delete(selected)
+
+	rows := make([dynamic]Row, 0, len(selected))
+	defer delete(rows)
+
+	for pos in selected {
+		conn := connections.connections[pos]
 
-	for conn in connections.connections {
 		when ODIN_OS == .Windows {
 			if conn.pid == 4 {continue} 	// system process, skip it for now even tho many sevices run under it
 		}
@@ -248,63 +461,94 @@ work :: proc() {
 					(conn.state == tcp.TCP_STATE_LISTEN || conn.state == tcp.TCP_STATE_ESTAB))
 
 		if should_include {
-			r := utils.get_proc_info(conn.pid)
-			if r == nil {
-				continue
-			}
-			if !opts.use_full {
-				r = filepath.base(r.?)
-			}
-			if opts.use_json {
-				title: Maybe(string)
-				when ODIN_OS == .Windows {
-					title = utils.get_window_title(tcp.get_hwnd(conn.pid))
-				} else {
-					title = "[not supported on linux]"
-				}
+			append(&rows, Row{conn = conn})
+		}
+	}
 
-				if r != nil && opts.search != "" {
-					if _, ok := regex.match(reg, r.?); !ok {
-						continue
-					}
-				}
+	resolve_rows(rp, rows[:], {pattern, reg_flags, opts.use_full})
 
-				append(
-					&json_struct,
-					json_out {
-						port = int(conn.local_port),
-						pid = int(conn.pid),
-						title = title,
-						path = r.?,
-					},
-				)
-			} else {
-				title: string
-				when ODIN_OS == .Windows {
-					title = utils.get_window_title(tcp.get_hwnd(conn.pid)).? or_else "[no window]"
+	json_struct := make([dynamic]json_out)
+	defer delete(json_struct)
+
+	// rows are already in index order, so a group is just a run of rows sharing the same value,
+	// for json only the offset where each group starts is kept since json_struct may still grow
+	group_labels := make([dynamic]string)
+	defer delete(group_labels)
+	group_starts := make([dynamic]int)
+	defer delete(group_starts)
+	current_group: u32
+	in_group := false
+
+	for row in rows {
+		if !row.keep {
+			continue
+		}
+
+		if opts.group {
+			value := group_value(row.conn, sort_key)
+			if !in_group || current_group != value {
+				label := group_label(sort_key, value)
+				if opts.use_json {
+					append(&group_labels, label)
+					append(&group_starts, len(json_struct))
 				} else {
-					title = "[not supported on linux]"
+					fmt.printf("[%s]\n", label)
 				}
+				current_group = value
+				in_group = true
+			}
+		}
 
-				if r != nil && opts.search != "" {
-					if _, ok := regex.match(reg, r.?); !ok {
-						continue
-					}
-				}
+		if opts.use_json {
+			title: Maybe(string)
+			when ODIN_OS == .Windows {
+				title = row.title
+			} else {
+				title = "[not supported on linux]"
+			}
 
-				fmt.printf(
-					"port: %#v, pid: %#v (title: %#v), path: %#v\n",
-					conn.local_port,
-					conn.pid,
-					title,
-					r,
-				)
+			append(
+				&json_struct,
+				json_out {
+					port = int(row.conn.local_port),
+					pid = int(row.conn.pid),
+					title = title,
+					path = row.path.?,
+				},
+			)
+		} else {
+			title: string
+			when ODIN_OS == .Windows {
+				title = row.title.? or_else "[no window]"
+			} else {
+				title = "[not supported on linux]"
 			}
+
+			fmt.printf(
+				"%sport: %#v, pid: %#v (title: %#v), path: %#v\n",
+				"\t" if opts.group else "",
+				row.conn.local_port,
+				row.conn.pid,
+				title,
+				row.path,
+			)
 		}
 	}
 
 	if opts.use_json {
-		data, err := json.marshal(json_struct, {pretty = true})
+		data: []byte
+		err: json.Marshal_Error
+		if opts.group {
+			json_groups := make([]json_group, len(group_starts))
+			defer delete(json_groups)
+			for start, i in group_starts {
+				end := group_starts[i + 1] if i + 1 < len(group_starts) else len(json_struct)
+				json_groups[i] = {group_labels[i], json_struct[start:end]}
+			}
+			data, err = json.marshal(json_groups, {pretty = true})
+		} else {
+			data, err = json.marshal(json_struct, {pretty = true})
+		}
 		defer delete(data)
 		if err != nil {
 			log.error(err)
@@ -0,0 +1,329 @@
+package main
+
+import "base:intrinsics"
+import "core:fmt"
+import "core:slice"
+import "core:testing"
+import "tcp"
+import "udp"
+
+// Common interface for both TCP and UDP connection types
+Connection_Info :: struct {
+	local_addr:  u32,
+	local_port:  u32,
+	remote_addr: u32,
+	remote_port: u32,
+	pid:         u32,
+	state:       u32, // Optional for UDP (always 0)
+}
+
+Connections :: struct {
+	count:       u32,
+	connections: []Connection_Info,
+}
+
+get_connections :: proc(use_udp: bool) -> (result: Connections) {
+	if use_udp {
+		udp_endpoints := udp.get_udp_endpoints()
+		if udp_endpoints == nil {
+			return {}
+		}
+		defer udp.free_udp_endpoints(udp_endpoints)
+
+		// Convert UDP endpoints to our common format
+		result.count = udp_endpoints.count
+		result.connections = make([]Connection_Info, int(udp_endpoints.count))
+
+		udp_slice := slice.from_ptr(udp_endpoints.endpoints, int(udp_endpoints.count))
+		for i := 0; i < int(udp_endpoints.count); i += 1 {
+			result.connections[i] = {
+				local_addr  = udp_slice[i].local_addr,
+				local_port  = u32(udp_slice[i].local_port),
+				remote_addr = udp_slice[i].remote_addr,
+				remote_port = u32(udp_slice[i].remote_port),
+				pid         = udp_slice[i].pid,
+				state       = 0, // UDP doesn't have states
+			}
+		}
+	} else {
+		tcp_connections := tcp.get_tcp_connections()
+		if tcp_connections == nil {
+			return {}
+		}
+		defer tcp.free_tcp_connections(tcp_connections)
+
+		// Convert TCP connections to our common format
+		result.count = tcp_connections.count
+		result.connections = make([]Connection_Info, int(tcp_connections.count))
+
+		tcp_slice := slice.from_ptr(tcp_connections.connections, int(tcp_connections.count))
+		for i := 0; i < int(tcp_connections.count); i += 1 {
+			result.connections[i] = {
+				local_addr  = tcp_slice[i].local_addr,
+				local_port  = u32(tcp_slice[i].local_port),
+				remote_addr = tcp_slice[i].remote_addr,
+				remote_port = u32(tcp_slice[i].remote_port),
+				pid         = tcp_slice[i].pid,
+				state       = tcp_slice[i].state,
+			}
+		}
+	}
+
+	return result
+}
+
+// keys the output can be sorted and grouped by, also the keys the snapshot is indexed on
+Sort_Key :: enum {
+	None,
+	Port,
+	Pid,
+	Remote,
+}
+
+// one slot of a secondary index, idx points back into the snapshot
+Index_Entry :: struct {
+	key: u32,
+	idx: u32,
+}
+
+// sorted indexes over a single get_connections snapshot, each one is built the first time its
+// key is asked for and kept until index_destroy. work() only builds the index for -sort, a
+// filter on that same key then binary searches it instead of scanning
+Connection_Index :: struct {
+	connections: []Connection_Info,
+	by:          [Sort_Key][]Index_Entry,
+}
+
+// remote addresses come in network byte order on windows and host byte order on linux,
+// the index always wants host order so that a /24 is a contiguous key range
+remote_host_order :: proc(addr: u32) -> u32 {
+	when ODIN_OS == .Windows {
+		return intrinsics.byte_swap(addr)
+	} else {
+		return addr
+	}
+}
+
+sort_key_value :: proc(conn: Connection_Info, key: Sort_Key) -> u32 {
+	switch key {
+	case .Port:
+		return conn.local_port
+	case .Pid:
+		return conn.pid
+	case .Remote:
+		return remote_host_order(conn.remote_addr)
+	case .None:
+	}
+	return 0
+}
+
+// the value rows are grouped on, same as the index key except remotes collapse into their /24
+group_value :: proc(conn: Connection_Info, key: Sort_Key) -> u32 {
+	v := sort_key_value(conn, key)
+	if key == .Remote {
+		v &= 0xFFFFFF00
+	}
+	return v
+}
+
+group_label :: proc(key: Sort_Key, value: u32) -> string {
+	switch key {
+	case .Port:
+		return fmt.tprintf("port %d", value)
+	case .Pid:
+		return fmt.tprintf("pid %d", value)
+	case .Remote:
+		return fmt.tprintf(
+			"remote %d.%d.%d.0/24",
+			(value >> 24) & 0xFF,
+			(value >> 16) & 0xFF,
+			(value >> 8) & 0xFF,
+		)
+	case .None:
+	}
+	return ""
+}
+
+// returns the entries of the index for key ordered by (key, snapshot position), so ties
+// keep the order the platform api reported them in and the output stays deterministic
+index_get :: proc(index: ^Connection_Index, key: Sort_Key) -> []Index_Entry {
+	if key == .None {
+		return nil
+	}
+	if index.by[key] != nil {
+		return index.by[key]
+	}
+
+	entries := make([]Index_Entry, len(index.connections))
+	for conn, i in index.connections {
+		entries[i] = {sort_key_value(conn, key), u32(i)}
+	}
+	slice.sort_by(entries, proc(a, b: Index_Entry) -> bool {
+		return a.key < b.key || (a.key == b.key && a.idx < b.idx)
+	})
+
+	index.by[key] = entries
+	return entries
+}
+
+// binary searches the index for every connection whose key lies in the inclusive range lo..=hi
+index_find :: proc(index: ^Connection_Index, key: Sort_Key, lo, hi: u32) -> []Index_Entry {
+	entries := index_get(index, key)
+	if lo > hi {
+		return nil
+	}
+
+	// first entry whose key is not below k
+	lower_bound :: proc(entries: []Index_Entry, k: u64) -> int {
+		lo, hi := 0, len(entries)
+		for lo < hi {
+			mid := lo + (hi - lo) / 2
+			if u64(entries[mid].key) < k {
+				lo = mid + 1
+			} else {
+				hi = mid
+			}
+		}
+		return lo
+	}
+
+	start := lower_bound(entries, u64(lo))
+	end := lower_bound(entries, u64(hi) + 1)
+	return entries[start:end]
+}
+
+// a query against one snapshot, every field that is set has to match
+Connection_Filter :: struct {
+	port:   Maybe(u32),
+	pid:    Maybe(u32),
+	remote: Maybe([2]u32), // inclusive range of host order addresses
+}
+
+filter_matches :: proc(conn: Connection_Info, filter: Connection_Filter) -> bool {
+	if port, ok := filter.port.?; ok && conn.local_port != port {
+		return false
+	}
+	if pid, ok := filter.pid.?; ok && conn.pid != pid {
+		return false
+	}
+	if remote, ok := filter.remote.?; ok {
+		addr := remote_host_order(conn.remote_addr)
+		if addr < remote[0] || addr > remote[1] {
+			return false
+		}
+	}
+	return true
+}
+
+// returns the snapshot positions matching the filter in sort_key order. only the sort_key
+// index is ever built (sorting needs it anyway), when the filter also constrains that key the
+// candidates shrink to its binary searched range, every other filter is a linear check so a
+// plain -port without -sort stays a single O(n) pass
+index_query :: proc(
+	index: ^Connection_Index,
+	filter: Connection_Filter,
+	sort_key: Sort_Key,
+	allocator := context.allocator,
+) -> []u32 {
+	result := make([dynamic]u32, 0, len(index.connections), allocator)
+
+	if sort_key == .None {
+		for conn, i in index.connections {
+			if filter_matches(conn, filter) {
+				append(&result, u32(i))
+			}
+		}
+		return result[:]
+	}
+
+	candidates := index_get(index, sort_key)
+	switch sort_key {
+	case .Port:
+		if port, ok := filter.port.?; ok {
+			candidates = index_find(index, .Port, port, port)
+		}
+	case .Pid:
+		if pid, ok := filter.pid.?; ok {
+			candidates = index_find(index, .Pid, pid, pid)
+		}
+	case .Remote:
+		if remote, ok := filter.remote.?; ok {
+			candidates = index_find(index, .Remote, remote[0], remote[1])
+		}
+	case .None:
+	}
+
+	for e in candidates {
+		if filter_matches(index.connections[e.idx], filter) {
+			append(&result, e.idx)
+		}
+	}
+	return result[:]
+}
+
+index_destroy :: proc(index: ^Connection_Index) {
+	for entries in index.by {
+		delete(entries)
+	}
+	index.by = {}
+}
+
+@(test)
+index_test :: proc(t: ^testing.T) {
+	conns := []Connection_Info {
+		{local_port = 443, pid = 30, remote_addr = remote_host_order(0x0A000105)},
+		{local_port = 80, pid = 10, remote_addr = remote_host_order(0x0A000201)},
+		{local_port = 443, pid = 20, remote_addr = remote_host_order(0x0A000101)},
+		{local_port = 22, pid = 10, remote_addr = remote_host_order(0xC0A80001)},
+	}
+	index := Connection_Index {
+		connections = conns,
+	}
+	defer index_destroy(&index)
+
+	by_port := index_get(&index, .Port)
+	testing.expect_value(t, len(by_port), 4)
+	testing.expect_value(t, by_port[0].idx, 3)
+	testing.expect_value(t, by_port[1].idx, 1)
+	testing.expect_value(t, by_port[2].idx, 0) // ties keep snapshot order
+	testing.expect_value(t, by_port[3].idx, 2)
+
+	testing.expect_value(t, len(index_find(&index, .Port, 443, 443)), 2)
+	testing.expect_value(t, len(index_find(&index, .Port, 8080, 8080)), 0)
+	testing.expect_value(t, len(index_find(&index, .Port, 0, max(u32))), 4)
+	testing.expect_value(t, len(index_find(&index, .Pid, 10, 10)), 2)
+	testing.expect_value(t, len(index_find(&index, .Remote, 0x0A000100, 0x0A0001FF)), 2)
+	testing.expect_value(t, len(index_find(&index, .Remote, 0xC0A80001, 0xC0A80001)), 1)
+
+	// second lookup reuses the index built by the first one
+	testing.expect(t, raw_data(index_get(&index, .Port)) == raw_data(by_port))
+
+
+	all := index_query(&index, {}, .Pid)
+	defer delete(all)
+	testing.expect(t, slice.equal(all, []u32{1, 3, 2, 0}))
+
+	https := index_query(&index, {port = u32(443)}, .Pid)
+	defer delete(https)
+	testing.expect(t, slice.equal(https, []u32{2, 0}))
+
+	both := index_query(&index, {port = u32(443), pid = u32(30), remote = [2]u32{0x0A000100, 0x0A0001FF}}, .None)
+	defer delete(both)
+	testing.expect(t, slice.equal(both, []u32{0}))
+
+	none := index_query(&index, {port = u32(80), pid = u32(30)}, .Port)
+	defer delete(none)
+	testing.expect_value(t, len(none), 0)
+
+	// filters on other keys than the sort key are scanned and never build their index
+	fresh := Connection_Index {
+		connections = conns,
+	}
+	defer index_destroy(&fresh)
+	scanned := index_query(&fresh, {pid = u32(10), remote = [2]u32{0x0A000200, 0x0A0002FF}}, .Port)
+	defer delete(scanned)
+	testing.expect(t, slice.equal(scanned, []u32{1}))
+	testing.expect(t, fresh.by[.Pid] == nil && fresh.by[.Remote] == nil)
+
+	testing.expect_value(t, group_label(.Remote, group_value(conns[0], .Remote)), "remote 10.0.1.0/24")
+}
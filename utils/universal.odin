@@ -77,3 +77,59 @@ trim_both_sides_test :: proc(t: ^testing.T) {
 	testing.expect_value(t, trim_both_sides("gabagool", "\""), "gabagool")
 	testing.expect_value(t, trim_both_sides("  \"gabagool\"  ", "\""), "gabagool")
 }
+
+// parses "a.b.c.d" or "a.b.c.d/N" into the inclusive range of host order addresses it covers
+parse_ipv4_range :: proc(s: string) -> (lo, hi: u32, ok: bool) {
+	input := strings.trim_space(s)
+	prefix := 32
+	if slash := strings.index_byte(input, '/'); slash >= 0 {
+		prefix = strconv.parse_int(input[slash + 1:], 10) or_return
+		if prefix < 0 || prefix > 32 {
+			return
+		}
+		input = input[:slash]
+	}
+
+	parts := strings.split(input, ".", context.temp_allocator)
+	if len(parts) != 4 {
+		return
+	}
+	addr: u32
+	for part in parts {
+		octet := strconv.parse_uint(part, 10) or_return
+		if octet > 255 {
+			return
+		}
+		addr = addr << 8 | u32(octet)
+	}
+
+	mask := prefix == 0 ? u32(0) : ~u32(0) << uint(32 - prefix)
+	return addr & mask, addr | ~mask, true
+}
+
+@(test)
+parse_ipv4_range_test :: proc(t: ^testing.T) {
+	lo, hi, ok := parse_ipv4_range("10.0.1.5")
+	testing.expect(t, ok)
+	testing.expect_value(t, lo, 0x0A000105)
+	testing.expect_value(t, hi, 0x0A000105)
+
+	lo, hi, ok = parse_ipv4_range(" 10.0.1.5/24 ")
+	testing.expect(t, ok)
+	testing.expect_value(t, lo, 0x0A000100)
+	testing.expect_value(t, hi, 0x0A0001FF)
+
+	lo, hi, ok = parse_ipv4_range("0.0.0.0/0")
+	testing.expect(t, ok)
+	testing.expect_value(t, lo, 0)
+	testing.expect_value(t, hi, max(u32))
+
+	_, _, ok = parse_ipv4_range("10.0.1")
+	testing.expect(t, !ok)
+	_, _, ok = parse_ipv4_range("10.0.1.256")
+	testing.expect(t, !ok)
+	_, _, ok = parse_ipv4_range("10.0.1.5/33")
+	testing.expect(t, !ok)
+	_, _, ok = parse_ipv4_range("example.com")
+	testing.expect(t, !ok)
+}
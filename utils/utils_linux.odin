@@ -34,3 +34,7 @@ get_proc_info :: proc(pid: u32) -> Maybe(string) {
 
 	return nil
 }
+
+current_pid :: proc() -> u32 {
+	return u32(posix.getpid())
+}
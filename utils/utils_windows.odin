@@ -194,3 +194,7 @@ get_child_pids :: proc(pid: win.DWORD) -> [dynamic]win.DWORD {
 
 	return children
 }
+
+current_pid :: proc() -> u32 {
+	return u32(win.GetCurrentProcessId())
+}